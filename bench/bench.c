@@ -0,0 +1,280 @@
+// Benchmark for the file system core, run with `make bench && ./fs_bench`.
+// Works on a throwaway disk image in a temporary directory; results go to stderr.
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "fs.h"
+#include "global_dir.h"
+#include "checksum.h"
+#include "block_cache.h"
+
+#define APPEND_OPS 2000
+#define APPEND_SIZE 512
+#define READ_FILES 64
+#define READ_CHUNK 4096
+#define OPEN_OPS 50
+#define SKEWED_FILES 256     // Hot and cold files each, created alternately
+#define SKEWED_READS 20000
+#define SKEWED_HOT_PERCENT 90
+#define CACHE_PAGE_BLOCKS 4  // Blocks per 4 KB page of the image
+#define CACHE_PAGES 96       // Capacity of the simulated page cache
+
+static double now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// Cost of checksumming one block with the accelerated and the table-driven implementation
+static double bench_checksums() {
+    for (int i = 0; i < MAX_BLOCKS; i++) {
+        for (int j = 0; j < BLOCK_SIZE; j++) {
+            virtual_disk[i][j] = (char)(i * 31 + j * 7);
+        }
+    }
+
+    uint32_t accelerated = 0;
+    double start = now_ns();
+    for (int i = 0; i < MAX_BLOCKS; i++) {
+        accelerated ^= crc32c(virtual_disk[i], BLOCK_SIZE);
+    }
+    double accelerated_ns = (now_ns() - start) / MAX_BLOCKS;
+
+    uint32_t table = 0;
+    start = now_ns();
+    for (int i = 0; i < MAX_BLOCKS; i++) {
+        table ^= crc32c_table(virtual_disk[i], BLOCK_SIZE);
+    }
+    double table_ns = (now_ns() - start) / MAX_BLOCKS;
+
+    fprintf(stderr, "crc32c %-14s %8.1f ns/block %6.2f GB/s\n", crc32c_implementation(), accelerated_ns,
+            BLOCK_SIZE / accelerated_ns);
+    fprintf(stderr, "crc32c %-14s %8.1f ns/block %6.2f GB/s\n", "table", table_ns, BLOCK_SIZE / table_ns);
+    if (accelerated != table) {
+        fprintf(stderr, "error: accelerated and table checksums differ\n");
+        exit(1);
+    }
+    return accelerated_ns;
+}
+
+// Latency of an append including the flush, which recomputes checksums of the touched blocks
+static void bench_write_path(double checksum_ns) {
+    FileSystem *fs;
+    if (fs_open(FS_DEFAULT_IMAGE, FS_OPEN_FRESH, &fs) < 0) {
+        fprintf(stderr, "error: could not create the benchmark image\n");
+        exit(1);
+    }
+
+    char content[APPEND_SIZE];
+    memset(content, 'x', APPEND_SIZE);
+
+    // Start a new file each time the previous one reaches the maximum file size
+    int appends_per_file = FS_MAX_FILE_SIZE / APPEND_SIZE;
+    char name[FS_MAX_NAME];
+
+    double start = now_ns();
+    for (int i = 0; i < APPEND_OPS; i++) {
+        snprintf(name, sizeof(name), "log%d", i / appends_per_file);
+        if (i % appends_per_file == 0) {
+            fs_create(fs, name, "", 0);
+        }
+        fs_append(fs, name, content, APPEND_SIZE);
+    }
+    double op_ns = (now_ns() - start) / APPEND_OPS;
+
+    // An append of at most one block dirties at most two blocks
+    double checksum_share = 2 * checksum_ns / op_ns * 100;
+    fprintf(stderr, "append %d B + flush   %8.1f us/op\n", APPEND_SIZE, op_ns / 1000);
+    fprintf(stderr, "checksum share of write path <= %.3f%%\n", checksum_share);
+    fs_close(fs);
+}
+
+// Drop the image from the page cache so reads go to the device (no effect on tmpfs)
+static void drop_page_cache() {
+    int fd = open(FS_DEFAULT_IMAGE, O_RDONLY);
+    if (fd >= 0) {
+        fdatasync(fd);
+        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        close(fd);
+    }
+}
+
+// Read every file front to back from a freshly opened image, with read-ahead capped at window blocks
+static void bench_sequential_read(int window, const char *label) {
+    drop_page_cache();
+    set_readahead_window(window);
+    FileSystem *fs;
+    if (fs_open(FS_DEFAULT_IMAGE, 0, &fs) < 0) {
+        fprintf(stderr, "error: could not open the benchmark image\n");
+        exit(1);
+    }
+
+    static char buffer[READ_CHUNK];
+    char name[FS_MAX_NAME];
+    long long total = 0;
+    double start = now_ns();
+    for (int i = 0; i < READ_FILES; i++) {
+        snprintf(name, sizeof(name), "data%d", i);
+        int bytes_read;
+        for (int offset = 0; (bytes_read = fs_read(fs, name, offset, buffer, READ_CHUNK)) > 0; offset += bytes_read) {
+            total += bytes_read;
+        }
+    }
+    double elapsed_ns = now_ns() - start;
+
+    BlockCacheStats stats;
+    get_block_cache_stats(&stats);
+    fprintf(stderr, "sequential read, %-14s %8.1f MB/s  %llu single reads, %llu batched reads, %llu/%llu prefetched blocks used\n",
+            label, total / elapsed_ns * 1e3, stats.demand_reads, stats.batched_reads, stats.prefetch_hits,
+            stats.blocks_prefetched);
+    fs_close(fs);
+}
+
+static void bench_read_path() {
+    FileSystem *fs;
+    if (fs_open(FS_DEFAULT_IMAGE, FS_OPEN_FRESH, &fs) < 0) {
+        fprintf(stderr, "error: could not create the benchmark image\n");
+        exit(1);
+    }
+    static char content[FS_MAX_FILE_SIZE];
+    memset(content, 'r', sizeof(content));
+    char name[FS_MAX_NAME];
+    for (int i = 0; i < READ_FILES; i++) {
+        snprintf(name, sizeof(name), "data%d", i);
+        fs_create(fs, name, content, sizeof(content));
+    }
+    fs_close(fs);
+
+    bench_sequential_read(1, "no read-ahead");
+    bench_sequential_read(READAHEAD_MAX_WINDOW, "read-ahead");
+    set_readahead_window(READAHEAD_MAX_WINDOW);
+}
+
+// Latency of opening an image and closing it again, dominated by loading and flushing the metadata
+static void bench_open(const char *label) {
+    FileSystem *fs;
+    double start = now_ns();
+    for (int i = 0; i < OPEN_OPS; i++) {
+        if (fs_open(FS_DEFAULT_IMAGE, 0, &fs) < 0) {
+            fprintf(stderr, "error: could not open the benchmark image\n");
+            exit(1);
+        }
+        fs_close(fs);
+    }
+    fprintf(stderr, "open + close, %-14s %8.1f us/op\n", label, (now_ns() - start) / OPEN_OPS / 1000);
+}
+
+// Metadata is stored for live blocks and directories only, so an empty image opens faster than a full one
+static void bench_startup() {
+    bench_open("64 files");
+    FileSystem *fs;
+    if (fs_open(FS_DEFAULT_IMAGE, FS_OPEN_FRESH, &fs) < 0) {
+        fprintf(stderr, "error: could not create the benchmark image\n");
+        exit(1);
+    }
+    fs_close(fs);
+    bench_open("empty image");
+}
+
+// LRU cache of image pages, standing in for a page cache smaller than the image
+static int cached_pages[CACHE_PAGES];
+static unsigned long long cached_used[CACHE_PAGES];
+static unsigned long long cache_clock;
+
+static int cache_access(int page) {
+    int victim = 0;
+    for (int i = 0; i < CACHE_PAGES; i++) {
+        if (cached_pages[i] == page) {
+            cached_used[i] = ++cache_clock;
+            return 1;
+        }
+        if (cached_used[i] < cached_used[victim]) {
+            victim = i;
+        }
+    }
+    cached_pages[victim] = page;
+    cached_used[victim] = ++cache_clock;
+    return 0;
+}
+
+// Read whole files, SKEWED_HOT_PERCENT of them from the hot set, and replay the blocks read through
+// the simulated cache. Returns the hit rate in percent.
+static double skewed_reads(FileSystem *fs) {
+    static char buffer[FS_MAX_FILE_SIZE];
+    for (int i = 0; i < CACHE_PAGES; i++) {
+        cached_pages[i] = -1;
+        cached_used[i] = 0;
+    }
+    unsigned int seed = 12345;  // Same sequence on every run
+    long long hits = 0;
+    long long accesses = 0;
+    char name[FS_MAX_NAME];
+    for (int i = 0; i < SKEWED_READS; i++) {
+        seed = seed * 1103515245 + 12345;
+        int hot = (int)((seed >> 8) % 100) < SKEWED_HOT_PERCENT;
+        seed = seed * 1103515245 + 12345;
+        snprintf(name, sizeof(name), "%s%u", hot ? "hot" : "cold", (seed >> 8) % SKEWED_FILES);
+        fs_read(fs, name, 0, buffer, sizeof(buffer));
+
+        FsStat stat;
+        fs_stat(fs, name, &stat);
+        for (int block = stat.start_block; block >= 0; block = FAT[block]) {
+            hits += cache_access(block / CACHE_PAGE_BLOCKS);
+            accesses++;
+        }
+    }
+    return 100.0 * hits / accesses;
+}
+
+// Hot files interleaved with cold ones waste most of every cached page; after migration they share
+// pages in the hot region
+static void bench_placement() {
+    FileSystem *fs;
+    if (fs_open(FS_DEFAULT_IMAGE, FS_OPEN_FRESH, &fs) < 0) {
+        fprintf(stderr, "error: could not create the benchmark image\n");
+        exit(1);
+    }
+    static char content[3 * BLOCK_SIZE];
+    memset(content, 'p', sizeof(content));
+    char name[FS_MAX_NAME];
+    for (int i = 0; i < SKEWED_FILES; i++) {
+        snprintf(name, sizeof(name), "hot%d", i);
+        fs_create(fs, name, content, BLOCK_SIZE);
+        snprintf(name, sizeof(name), "cold%d", i);
+        fs_create(fs, name, content, sizeof(content));
+    }
+
+    double before = skewed_reads(fs);
+    int moved;
+    double start = now_ns();
+    fs_placement_migrate(fs, 0, &moved);
+    double migrate_ms = (now_ns() - start) / 1e6;
+    double after = skewed_reads(fs);
+
+    FsPlacementReport report;
+    fs_placement_report(fs, &report);
+    fprintf(stderr, "skewed reads, %d-page cache  %5.1f%% hits interleaved, %5.1f%% after moving %d blocks (%.1f ms), "
+            "%d/%d hot blocks in region\n", CACHE_PAGES, before, after, moved, migrate_ms,
+            report.hot_blocks_in_region, report.hot_blocks);
+    fs_close(fs);
+}
+
+int main() {
+    char directory[] = "/tmp/fs_bench.XXXXXX";
+    if (mkdtemp(directory) == NULL || chdir(directory) != 0) {
+        perror("Error creating benchmark directory");
+        return 1;
+    }
+
+    double checksum_ns = bench_checksums();
+    bench_write_path(checksum_ns);
+    bench_read_path();
+    bench_startup();
+    bench_placement();
+
+    remove(FS_DEFAULT_IMAGE);
+    rmdir(directory);
+    return 0;
+}